@@ -0,0 +1,330 @@
+/*****************************************************************************************
+ * bench_io.cpp – page‑I/O microbenchmarks for tinydb's StorageManager
+ *
+ *  * Measures allocatePage, writePage and readPage.
+ *  * Sweeps access pattern (sequential / random), working‑set size (as a
+ *    fraction of physical RAM), thread count and sync mode.
+ *  * Emits one JSON document so runs can be diffed across versions.
+ *  * --vfs memory takes the disk out of the picture (pure CPU cost);
+ *    --latency-us models a slow disk on top of any backend.
+ *
+ * Compile (from the repository root):
+ *   g++ -std=c++17 -O2 -Wall -Wextra -pthread -o bench_io bench/bench_io.cpp
+ *
+ * Run:
+ *   ./bench_io --working-sets 0.001,0.01 --threads 1,4 --sync none,batch \
+ *              --label "$(git describe --always)" --json bench_io.json
+ *
+ *****************************************************************************************/
+
+#define TINYDB_NO_MAIN
+#include "../tinydb.cpp"
+#include "bench_util.h"
+
+// -----------------------------------------------------------------------------
+// Configuration
+// -----------------------------------------------------------------------------
+enum class SyncMode : uint32_t {
+    NONE  = 0,   // Leave written pages in the OS page cache
+    BATCH = 1,   // sync() every SYNC_BATCH writes per thread
+    EVERY = 2    // sync() after every write
+};
+constexpr uint32_t SYNC_BATCH = 64;
+
+struct BenchConfig {
+    std::string           dbPath{"bench_io.db"};
+    std::string           jsonPath;                 // empty = stdout
+    std::string           label;                    // e.g. git describe output
+    uint64_t              opsPerRun{20000};
+    std::vector<double>   workingSets{0.001, 0.01}; // fractions of physical RAM
+    std::vector<uint32_t> threadCounts{1, 4};
+    std::vector<SyncMode> syncModes{SyncMode::NONE, SyncMode::BATCH};
+    bool                  cold{false};              // drop the file from the page cache before reads
+    std::string           vfsName{"posix"};         // posix, mmap or memory
+    uint32_t              latencyUs{0};             // injected per read/write/sync
+};
+
+struct BenchResult {
+    std::string op;
+    std::string pattern;
+    std::string sync;
+    double      workingSetRatio{};
+    uint32_t    workingSetPages{};
+    uint32_t    threads{};
+    uint64_t    ops{};
+    double      seconds{};
+    double      p50Ns{};
+    double      p99Ns{};
+    uint64_t    errors{};
+};
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+static const char* syncName(SyncMode mode) {
+    switch (mode) {
+        case SyncMode::NONE:  return "none";
+        case SyncMode::BATCH: return "batch";
+        case SyncMode::EVERY: return "every";
+        default:              return "unknown";
+    }
+}
+
+static void dropFromPageCache(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+#if defined(POSIX_FADV_DONTNEED)
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    ::close(fd);
+}
+
+// -----------------------------------------------------------------------------
+// Run `opsPerThread` operations on each of `threads` threads.
+// `op(thread, i)` performs the i‑th operation of a thread.
+// -----------------------------------------------------------------------------
+static BenchResult runThreads(uint32_t threads, uint64_t totalOps,
+                              const std::function<ErrorCode(uint32_t, uint64_t)>& op) {
+    BenchResult result;
+    result.threads = threads;
+    uint64_t opsPerThread = std::max<uint64_t>(1, totalOps / threads);
+    std::vector<std::vector<uint64_t>> latencies(threads);
+    std::vector<uint64_t> errors(threads, 0);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (uint32_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            latencies[t].reserve(opsPerThread);
+            for (uint64_t i = 0; i < opsPerThread; ++i) {
+                auto begin = std::chrono::steady_clock::now();
+                if (op(t, i) != ErrorCode::SUCCESS)
+                    ++errors[t];
+                latencies[t].push_back(elapsedNs(begin));
+            }
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<uint64_t> all;
+    for (uint32_t t = 0; t < threads; ++t) {
+        all.insert(all.end(), latencies[t].begin(), latencies[t].end());
+        result.errors += errors[t];
+    }
+    result.ops   = all.size();
+    result.p50Ns = percentile(all, 0.50);
+    result.p99Ns = percentile(all, 0.99);
+    return result;
+}
+
+// -----------------------------------------------------------------------------
+// One working‑set size × thread count: allocate, then write and read it
+// -----------------------------------------------------------------------------
+static void benchWorkingSet(const BenchConfig& cfg, double ratio, uint32_t wsPages,
+                            uint32_t threads, std::vector<BenchResult>& results) {
+    Vfs* base = findVfs(cfg.vfsName);
+    FaultConfig faults;
+    faults.readLatencyUs = faults.writeLatencyUs = faults.syncLatencyUs = cfg.latencyUs;
+    FaultInjectingVfs slowVfs(*base, faults);
+    StorageOptions options;
+    options.vfs = cfg.latencyUs > 0 ? static_cast<Vfs*>(&slowVfs) : base;
+
+    options.vfs->remove(cfg.dbPath);
+    StorageManager storage;
+    if (auto rc = storage.open(cfg.dbPath, options); rc != ErrorCode::SUCCESS) {
+        std::cerr << "bench_io: cannot open '" << cfg.dbPath << "': " << errorMessage(rc) << "\n";
+        return;
+    }
+    auto record = [&](BenchResult r, const char* op, const char* pattern, const char* sync) {
+        r.op = op;
+        r.pattern = pattern;
+        r.sync = sync;
+        r.workingSetRatio = ratio;
+        r.workingSetPages = wsPages;
+        results.push_back(std::move(r));
+        std::cerr << "  " << std::left << std::setw(13) << op << std::setw(11) << pattern
+                  << std::setw(6) << sync << " pages=" << wsPages << " threads=" << threads
+                  << " ops/s=" << static_cast<uint64_t>(results.back().ops / results.back().seconds)
+                  << "\n";
+    };
+
+    // allocatePage – the file grows to the working‑set size
+    record(runThreads(threads, wsPages, [&](uint32_t, uint64_t) {
+        uint32_t page;
+        return storage.allocatePage(page);
+    }), "allocatePage", "append", "none");
+    uint32_t pages = storage.getPageCount() - 1;   // data pages 1..pages
+    if (pages == 0)
+        return;
+
+    auto sequentialPage = [pages, threads](uint32_t t, uint64_t i) {
+        uint64_t stripe = std::max<uint64_t>(1, pages / threads);
+        return static_cast<uint32_t>(1 + (t * stripe + i) % pages);
+    };
+    std::vector<std::mt19937_64> rngs;
+    for (uint32_t t = 0; t < threads; ++t)
+        rngs.emplace_back(0x7157DBull + t);
+    auto randomPage = [&rngs, pages](uint32_t t, uint64_t) {
+        return static_cast<uint32_t>(1 + rngs[t]() % pages);
+    };
+
+    // writePage – every sync mode, both patterns
+    for (SyncMode mode : cfg.syncModes) {
+        for (int random = 0; random < 2; ++random) {
+            record(runThreads(threads, cfg.opsPerRun, [&](uint32_t t, uint64_t i) {
+                thread_local std::vector<char> buffer(PAGE_SIZE, 0x5A);
+                uint32_t page = random ? randomPage(t, i) : sequentialPage(t, i);
+                ErrorCode rc = storage.writePage(page, buffer.data());
+                if (rc == ErrorCode::SUCCESS &&
+                    (mode == SyncMode::EVERY ||
+                     (mode == SyncMode::BATCH && (i + 1) % SYNC_BATCH == 0)))
+                    rc = storage.sync();
+                return rc;
+            }), "writePage", random ? "random" : "sequential", syncName(mode));
+        }
+    }
+
+    // readPage – sync mode does not apply
+    storage.sync();
+    for (int random = 0; random < 2; ++random) {
+        if (cfg.cold && cfg.vfsName != "memory")
+            dropFromPageCache(cfg.dbPath);
+        record(runThreads(threads, cfg.opsPerRun, [&](uint32_t t, uint64_t i) {
+            thread_local std::vector<char> buffer(PAGE_SIZE);
+            uint32_t page = random ? randomPage(t, i) : sequentialPage(t, i);
+            return storage.readPage(page, buffer.data());
+        }), "readPage", random ? "random" : "sequential", cfg.cold ? "cold" : "warm");
+    }
+    storage.close();
+    options.vfs->remove(cfg.dbPath);
+}
+
+// -----------------------------------------------------------------------------
+// JSON output
+// -----------------------------------------------------------------------------
+static void writeJson(std::ostream& out, const BenchConfig& cfg, uint64_t ramBytes,
+                      const std::vector<BenchResult>& results) {
+    out << std::setprecision(6);
+    out << "{\n"
+        << "  \"benchmark\": \"tinydb_page_io\",\n"
+        << "  \"label\": \"" << cfg.label << "\",\n"
+        << "  \"vfs\": \"" << cfg.vfsName << "\",\n"
+        << "  \"latency_us\": " << cfg.latencyUs << ",\n"
+        << "  \"page_size\": " << PAGE_SIZE << ",\n"
+        << "  \"ram_bytes\": " << ramBytes << ",\n"
+        << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+        << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        double opsPerSec = r.seconds > 0 ? static_cast<double>(r.ops) / r.seconds : 0.0;
+        out << "    {\"op\": \"" << r.op << "\", \"pattern\": \"" << r.pattern
+            << "\", \"sync\": \"" << r.sync
+            << "\", \"working_set_ratio\": " << r.workingSetRatio
+            << ", \"working_set_pages\": " << r.workingSetPages
+            << ", \"threads\": " << r.threads
+            << ", \"ops\": " << r.ops
+            << ", \"errors\": " << r.errors
+            << ", \"seconds\": " << r.seconds
+            << ", \"ops_per_sec\": " << opsPerSec
+            << ", \"mb_per_sec\": " << opsPerSec * PAGE_SIZE / (1024.0 * 1024.0)
+            << ", \"p50_ns\": " << r.p50Ns
+            << ", \"p99_ns\": " << r.p99Ns << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+static void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options]\n"
+              << "  --db PATH              scratch database file (default bench_io.db)\n"
+              << "  --ops N                operations per write/read run (default 20000)\n"
+              << "  --working-sets LIST    working‑set sizes as fractions of RAM (default 0.001,0.01)\n"
+              << "  --threads LIST         thread counts (default 1,4)\n"
+              << "  --sync LIST            none,batch,every (default none,batch)\n"
+              << "  --cold                 drop the file from the page cache before reads\n"
+              << "  --vfs NAME             posix, mmap or memory (default posix)\n"
+              << "  --latency-us N         inject N µs per read, write and sync\n"
+              << "  --label TEXT           free‑form build label stored in the JSON\n"
+              << "  --json PATH            write JSON here instead of stdout\n";
+}
+
+int main(int argc, char* argv[])
+{
+    BenchConfig cfg;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                std::exit(1);
+            }
+            return argv[++i];
+        };
+        if (arg == "--db") {
+            cfg.dbPath = next();
+        } else if (arg == "--ops") {
+            cfg.opsPerRun = std::stoull(next());
+        } else if (arg == "--working-sets") {
+            cfg.workingSets.clear();
+            for (const auto& item : splitList(next()))
+                cfg.workingSets.push_back(std::stod(item));
+        } else if (arg == "--threads") {
+            cfg.threadCounts.clear();
+            for (const auto& item : splitList(next()))
+                cfg.threadCounts.push_back(static_cast<uint32_t>(std::max(1, std::stoi(item))));
+        } else if (arg == "--sync") {
+            cfg.syncModes.clear();
+            for (const auto& item : splitList(next())) {
+                std::string mode = toUpper(item);
+                if (mode == "NONE")       cfg.syncModes.push_back(SyncMode::NONE);
+                else if (mode == "BATCH") cfg.syncModes.push_back(SyncMode::BATCH);
+                else if (mode == "EVERY") cfg.syncModes.push_back(SyncMode::EVERY);
+                else { usage(argv[0]); return 1; }
+            }
+        } else if (arg == "--cold") {
+            cfg.cold = true;
+        } else if (arg == "--vfs") {
+            cfg.vfsName = next();
+            if (findVfs(cfg.vfsName) == nullptr) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--latency-us") {
+            cfg.latencyUs = static_cast<uint32_t>(std::stoul(next()));
+        } else if (arg == "--label") {
+            cfg.label = next();
+        } else if (arg == "--json") {
+            cfg.jsonPath = next();
+        } else {
+            usage(argv[0]);
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    uint64_t ramBytes = physicalRamBytes();
+    std::vector<BenchResult> results;
+    for (double ratio : cfg.workingSets) {
+        uint64_t bytes = static_cast<uint64_t>(ratio * static_cast<double>(ramBytes));
+        uint32_t wsPages = static_cast<uint32_t>(std::max<uint64_t>(1, bytes / PAGE_SIZE));
+        for (uint32_t threads : cfg.threadCounts) {
+            std::cerr << "working set " << ratio << "x RAM (" << wsPages << " pages), "
+                      << threads << " thread(s)\n";
+            benchWorkingSet(cfg, ratio, wsPages, threads, results);
+        }
+    }
+
+    if (cfg.jsonPath.empty()) {
+        writeJson(std::cout, cfg, ramBytes, results);
+    } else {
+        std::ofstream out(cfg.jsonPath);
+        if (!out) {
+            std::cerr << "bench_io: cannot write '" << cfg.jsonPath << "'\n";
+            return 1;
+        }
+        writeJson(out, cfg, ramBytes, results);
+    }
+    return 0;
+}
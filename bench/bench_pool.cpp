@@ -0,0 +1,270 @@
+/*****************************************************************************************
+ * bench_pool.cpp – many‑thread read scalability of tinydb's BufferPool
+ *
+ *  * Fills a database, opens it with a buffer pool and warms the pool.
+ *  * Runs readPage from 1..N threads, uniform or hotspot (90% of reads to
+ *    10% of the pages), for each page‑table partition count.
+ *  * --partitions 1 is a single latch; 0 is the default sharding.
+ *  * Emits one JSON document so runs can be diffed across versions.
+ *
+ * Compile (from the repository root):
+ *   g++ -std=c++17 -O2 -Wall -Wextra -pthread -o bench_pool bench/bench_pool.cpp
+ *
+ * Run:
+ *   ./bench_pool --pages 50000 --threads 1,4,16,64 --partitions 1,0 \
+ *                --label "$(git describe --always)" --json bench_pool.json
+ *
+ *****************************************************************************************/
+
+#define TINYDB_NO_MAIN
+#include "../tinydb.cpp"
+#include "bench_util.h"
+
+// -----------------------------------------------------------------------------
+// Configuration
+// -----------------------------------------------------------------------------
+struct BenchConfig {
+    std::string              dbPath{"bench_pool.db"};
+    std::string              jsonPath;                    // empty = stdout
+    std::string              label;                       // e.g. git describe output
+    uint32_t                 pages{20000};                // data pages in the file
+    uint32_t                 poolPages{0};                // 0 = every page fits
+    uint64_t                 opsPerRun{400000};
+    std::vector<uint32_t>    threadCounts{1, 2, 4, 8, 16};
+    std::vector<uint32_t>    partitionCounts{1, 0};
+    std::vector<std::string> patterns{"uniform", "hotspot"};
+    std::string              vfsName{"posix"};
+};
+
+struct BenchResult {
+    std::string pattern;
+    uint32_t    partitions{};                 // as opened (after the default is applied)
+    uint32_t    threads{};
+    uint64_t    ops{};
+    double      seconds{};
+    double      p50Ns{};
+    double      p99Ns{};
+    double      hitRatio{};
+    uint64_t    errors{};
+};
+
+static uint64_t counter(Counter c) {
+    return getStats().counters[static_cast<size_t>(c)];
+}
+
+// -----------------------------------------------------------------------------
+// `threads` readers, `opsPerRun` reads in total; every 64th read is timed
+// -----------------------------------------------------------------------------
+static BenchResult runReaders(StorageManager& storage, const BenchConfig& cfg,
+                              const std::string& pattern, uint32_t threads) {
+    BenchResult result;
+    result.pattern = pattern;
+    result.threads = threads;
+    uint64_t opsPerThread = std::max<uint64_t>(1, cfg.opsPerRun / threads);
+    std::vector<std::vector<uint64_t>> latencies(threads);
+    std::vector<uint64_t> errors(threads, 0);
+    bool hotspot = pattern == "hotspot";
+    uint32_t hotPages = std::max<uint32_t>(1, cfg.pages / 10);
+
+    uint64_t hits0 = counter(Counter::POOL_HITS), misses0 = counter(Counter::POOL_MISSES);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (uint32_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            std::mt19937_64 rng(0x9001ull + t);
+            std::vector<char> buffer(PAGE_SIZE);
+            latencies[t].reserve(opsPerThread / 64 + 1);
+            for (uint64_t i = 0; i < opsPerThread; ++i) {
+                uint64_t r = rng();
+                uint32_t page = hotspot && r % 10 != 0 ? 1 + static_cast<uint32_t>((r >> 8) % hotPages)
+                                                       : 1 + static_cast<uint32_t>((r >> 8) % cfg.pages);
+                bool timed = i % 64 == 0;
+                auto begin = timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+                if (storage.readPage(page, buffer.data()) != ErrorCode::SUCCESS)
+                    ++errors[t];
+                if (timed)
+                    latencies[t].push_back(elapsedNs(begin));
+            }
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<uint64_t> all;
+    for (uint32_t t = 0; t < threads; ++t) {
+        all.insert(all.end(), latencies[t].begin(), latencies[t].end());
+        result.errors += errors[t];
+    }
+    result.ops   = opsPerThread * threads;
+    result.p50Ns = percentile(all, 0.50);
+    result.p99Ns = percentile(all, 0.99);
+    uint64_t hits = counter(Counter::POOL_HITS) - hits0, misses = counter(Counter::POOL_MISSES) - misses0;
+    result.hitRatio = hits + misses > 0 ? static_cast<double>(hits) / static_cast<double>(hits + misses) : 0.0;
+    return result;
+}
+
+// -----------------------------------------------------------------------------
+// JSON output
+// -----------------------------------------------------------------------------
+static void writeJson(std::ostream& out, const BenchConfig& cfg, uint32_t poolPages,
+                      const std::vector<BenchResult>& results) {
+    out << std::setprecision(6);
+    out << "{\n"
+        << "  \"benchmark\": \"tinydb_buffer_pool\",\n"
+        << "  \"label\": \"" << cfg.label << "\",\n"
+        << "  \"vfs\": \"" << cfg.vfsName << "\",\n"
+        << "  \"page_size\": " << PAGE_SIZE << ",\n"
+        << "  \"pages\": " << cfg.pages << ",\n"
+        << "  \"pool_pages\": " << poolPages << ",\n"
+        << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+        << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        double opsPerSec = r.seconds > 0 ? static_cast<double>(r.ops) / r.seconds : 0.0;
+        out << "    {\"pattern\": \"" << r.pattern
+            << "\", \"partitions\": " << r.partitions
+            << ", \"threads\": " << r.threads
+            << ", \"ops\": " << r.ops
+            << ", \"errors\": " << r.errors
+            << ", \"seconds\": " << r.seconds
+            << ", \"ops_per_sec\": " << opsPerSec
+            << ", \"hit_ratio\": " << r.hitRatio
+            << ", \"p50_ns\": " << r.p50Ns
+            << ", \"p99_ns\": " << r.p99Ns << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+static void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options]\n"
+              << "  --db PATH              scratch database file (default bench_pool.db)\n"
+              << "  --pages N              data pages in the file (default 20000)\n"
+              << "  --pool-pages N         buffer pool frames (default: all pages fit)\n"
+              << "  --ops N                reads per run, over all threads (default 400000)\n"
+              << "  --threads LIST         thread counts (default 1,2,4,8,16)\n"
+              << "  --partitions LIST      page‑table partitions, 0 = default (default 1,0)\n"
+              << "  --patterns LIST        uniform,hotspot (default both)\n"
+              << "  --vfs NAME             posix, mmap or memory (default posix)\n"
+              << "  --label TEXT           free‑form build label stored in the JSON\n"
+              << "  --json PATH            write JSON here instead of stdout\n";
+}
+
+int main(int argc, char* argv[])
+{
+    BenchConfig cfg;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                std::exit(1);
+            }
+            return argv[++i];
+        };
+        if (arg == "--db") {
+            cfg.dbPath = next();
+        } else if (arg == "--pages") {
+            cfg.pages = static_cast<uint32_t>(std::max(1ul, std::stoul(next())));
+        } else if (arg == "--pool-pages") {
+            cfg.poolPages = static_cast<uint32_t>(std::stoul(next()));
+        } else if (arg == "--ops") {
+            cfg.opsPerRun = std::stoull(next());
+        } else if (arg == "--threads") {
+            cfg.threadCounts.clear();
+            for (const auto& item : splitList(next()))
+                cfg.threadCounts.push_back(static_cast<uint32_t>(std::max(1, std::stoi(item))));
+        } else if (arg == "--partitions") {
+            cfg.partitionCounts.clear();
+            for (const auto& item : splitList(next()))
+                cfg.partitionCounts.push_back(static_cast<uint32_t>(std::max(0, std::stoi(item))));
+        } else if (arg == "--patterns") {
+            cfg.patterns.clear();
+            for (const auto& item : splitList(next())) {
+                if (item != "uniform" && item != "hotspot") {
+                    usage(argv[0]);
+                    return 1;
+                }
+                cfg.patterns.push_back(item);
+            }
+        } else if (arg == "--vfs") {
+            cfg.vfsName = next();
+            if (findVfs(cfg.vfsName) == nullptr) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--label") {
+            cfg.label = next();
+        } else if (arg == "--json") {
+            cfg.jsonPath = next();
+        } else {
+            usage(argv[0]);
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+    uint32_t poolPages = cfg.poolPages != 0 ? cfg.poolPages : cfg.pages + 1;
+
+    // Build the file once; every run reopens it with its own pool
+    Vfs* vfs = findVfs(cfg.vfsName);
+    StorageOptions options;
+    options.vfs = vfs;
+    vfs->remove(cfg.dbPath);
+    {
+        StorageManager storage;
+        if (auto rc = storage.open(cfg.dbPath, options); rc != ErrorCode::SUCCESS) {
+            std::cerr << "bench_pool: cannot open '" << cfg.dbPath << "': " << errorMessage(rc) << "\n";
+            return 1;
+        }
+        std::vector<char> page(PAGE_SIZE);
+        for (uint32_t p = 1; p <= cfg.pages; ++p) {
+            uint32_t pageNumber;
+            storage.allocatePage(pageNumber);
+            std::memcpy(page.data(), &pageNumber, sizeof(pageNumber));
+            storage.writePage(pageNumber, page.data());
+        }
+        storage.sync();
+    }
+
+    std::vector<BenchResult> results;
+    options.bufferPoolPages  = poolPages;
+    options.bufferPoolWarmup = false;   // every run warms its own pool below
+    for (uint32_t partitions : cfg.partitionCounts) {
+        options.bufferPoolPartitions = partitions;
+        StorageManager storage;
+        if (auto rc = storage.open(cfg.dbPath, options); rc != ErrorCode::SUCCESS) {
+            std::cerr << "bench_pool: cannot open '" << cfg.dbPath << "': " << errorMessage(rc) << "\n";
+            return 1;
+        }
+        // Two passes: the second finds the first's ghosts and fills Am
+        std::vector<char> page(PAGE_SIZE);
+        for (int pass = 0; pass < 2; ++pass)
+            for (uint32_t p = 1; p <= cfg.pages; ++p)
+                storage.readPage(p, page.data());
+        uint32_t opened = storage.getPoolPartitions();
+        for (const std::string& pattern : cfg.patterns) {
+            for (uint32_t threads : cfg.threadCounts) {
+                BenchResult r = runReaders(storage, cfg, pattern, threads);
+                r.partitions = opened;
+                std::cerr << "  " << std::left << std::setw(8) << pattern << " partitions=" << opened
+                          << " threads=" << threads
+                          << " ops/s=" << static_cast<uint64_t>(static_cast<double>(r.ops) / r.seconds)
+                          << " hit=" << r.hitRatio << "\n";
+                results.push_back(std::move(r));
+            }
+        }
+    }
+    vfs->remove(cfg.dbPath);
+
+    if (cfg.jsonPath.empty()) {
+        writeJson(std::cout, cfg, poolPages, results);
+    } else {
+        std::ofstream out(cfg.jsonPath);
+        if (!out) {
+            std::cerr << "bench_pool: cannot write '" << cfg.jsonPath << "'\n";
+            return 1;
+        }
+        writeJson(out, cfg, poolPages, results);
+    }
+    return 0;
+}
@@ -0,0 +1,39 @@
+/*****************************************************************************************
+ * bench_util.h – helpers shared by the bench/ programs (include after tinydb.cpp)
+ *****************************************************************************************/
+#pragma once
+
+#include <random>
+#include <iomanip>
+#include <functional>
+
+// Split a comma‑separated command‑line list ("1,2,4") into trimmed items
+[[maybe_unused]] static std::vector<std::string> splitList(const std::string& text) {
+    std::vector<std::string> items;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        if (!trim(item).empty())
+            items.push_back(trim(item));
+    return items;
+}
+
+[[maybe_unused]] static uint64_t physicalRamBytes() {
+    long pages = ::sysconf(_SC_PHYS_PAGES);
+    long size  = ::sysconf(_SC_PAGE_SIZE);
+    return (pages > 0 && size > 0) ? static_cast<uint64_t>(pages) * static_cast<uint64_t>(size) : 0;
+}
+
+// p in [0,1]; reorders `samples`
+[[maybe_unused]] static double percentile(std::vector<uint64_t>& samples, double p) {
+    if (samples.empty())
+        return 0.0;
+    size_t idx = static_cast<size_t>(p * static_cast<double>(samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + idx, samples.end());
+    return static_cast<double>(samples[idx]);
+}
+
+[[maybe_unused]] static uint64_t elapsedNs(std::chrono::steady_clock::time_point begin) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - begin).count());
+}
@@ -0,0 +1,524 @@
+/*****************************************************************************************
+ * tpch_lite.cpp – TPC‑H‑inspired analytical benchmark for tinydb
+ *
+ *  * Built‑in data generator for CUSTOMER, ORDERS and LINEITEM at any scale
+ *    factor (SF 1 ≈ 150K customers, 1.5M orders, ~6M line items).
+ *  * Columns use tinydb's DataTypes (INTEGER, FLOAT, DOUBLE, STRING) and are
+ *    described with ColumnDefinition. Rows are fixed width and packed into
+ *    pages behind a PageHeader (entryCount = rows, nextPage = next page).
+ *  * tinydb has no executor yet, so the queries are hand‑written operators
+ *    over StorageManager::readPage. They cover scan‑filter‑aggregate,
+ *    hash joins, group‑by and top‑k:
+ *      Q1   pricing summary        – scan, filter, group‑by aggregate
+ *      Q3   shipping priority      – 3‑way hash join, group‑by, top‑10
+ *      Q6   forecast revenue       – scan, selective filter, sum
+ *      Q10  returned items         – 2‑way hash join, group‑by, top‑20
+ *      TOPK largest orders         – scan, top‑100 heap
+ *  * Reports per‑query runtime (min / median over --runs) per scale factor.
+ *
+ * Compile (from the repository root):
+ *   g++ -std=c++17 -O2 -Wall -Wextra -pthread -o tpch_lite bench/tpch_lite.cpp
+ *
+ * Run:
+ *   ./tpch_lite --scale 0.01,0.05,0.1 --runs 3 --json tpch.json
+ *
+ *****************************************************************************************/
+
+#define TINYDB_NO_MAIN
+#include "../tinydb.cpp"
+#include "bench_util.h"
+
+#include <unordered_map>
+#include <queue>
+
+// -----------------------------------------------------------------------------
+// Constants (dates are days since 1992‑01‑01)
+// -----------------------------------------------------------------------------
+constexpr int32_t  DATE_1994_01_01  = 731;
+constexpr int32_t  DATE_1995_01_01  = 1096;
+constexpr int32_t  DATE_1995_03_15  = 1169;
+constexpr int32_t  DATE_1995_06_17  = 1263;   // TPC‑H "current date"
+constexpr int32_t  DATE_1998_08_02  = 2405;
+constexpr int32_t  DATE_1998_09_02  = 2436;   // Q1 cutoff (1998‑12‑01 − 90 days)
+constexpr uint32_t ROWS_PAGE_OFFSET = sizeof(PageHeader);
+
+static const char* const SEGMENTS[]   = { "AUTOMOBILE", "BUILDING", "FURNITURE", "MACHINERY", "HOUSEHOLD" };
+static const char* const PRIORITIES[] = { "1-URGENT", "2-HIGH", "3-MEDIUM", "4-NOT SPECIFIED", "5-LOW" };
+
+// -----------------------------------------------------------------------------
+// Fixed‑width table layout
+// -----------------------------------------------------------------------------
+static ColumnDefinition makeColumn(const char* name, DataType type, uint32_t size = 0) {
+    ColumnDefinition col{};
+    std::strncpy(col.columnName, name, MAX_IDENTIFIER_LENGTH - 1);
+    col.dataType = static_cast<uint32_t>(type);
+    switch (type) {
+        case DataType::INTEGER: col.dataSize = sizeof(int32_t); break;
+        case DataType::FLOAT:   col.dataSize = sizeof(float);   break;
+        case DataType::DOUBLE:  col.dataSize = sizeof(double);  break;
+        case DataType::STRING:  col.dataSize = size;            break;
+    }
+    return col;
+}
+
+struct Table {
+    std::string                   name;
+    std::vector<ColumnDefinition> columns;
+    std::vector<uint32_t>         offsets;    // byte offset of each column in a row
+    uint32_t                      rowSize{0};
+    uint32_t                      rowsPerPage{0};
+    std::vector<uint32_t>         pages;      // data pages in scan order
+    uint64_t                      rows{0};
+
+    Table(std::string n, std::vector<ColumnDefinition> cols)
+        : name(std::move(n)), columns(std::move(cols)) {
+        for (const auto& col : columns) {
+            offsets.push_back(rowSize);
+            rowSize += col.dataSize;
+        }
+        rowsPerPage = (PAGE_SIZE - ROWS_PAGE_OFFSET) / rowSize;
+    }
+};
+
+// Column indices (kept next to the schemas below)
+enum CustomerCol : uint32_t { C_CUSTKEY, C_NATIONKEY, C_MKTSEGMENT, C_ACCTBAL };
+enum OrdersCol   : uint32_t { O_ORDERKEY, O_CUSTKEY, O_ORDERDATE, O_TOTALPRICE, O_ORDERPRIORITY };
+enum LineitemCol : uint32_t { L_ORDERKEY, L_PARTKEY, L_QUANTITY, L_EXTENDEDPRICE, L_DISCOUNT,
+                              L_TAX, L_RETURNFLAG, L_LINESTATUS, L_SHIPDATE };
+
+static Table customerTable() {
+    return Table("customer", { makeColumn("c_custkey", DataType::INTEGER),
+                               makeColumn("c_nationkey", DataType::INTEGER),
+                               makeColumn("c_mktsegment", DataType::STRING, 10),
+                               makeColumn("c_acctbal", DataType::DOUBLE) });
+}
+static Table ordersTable() {
+    return Table("orders", { makeColumn("o_orderkey", DataType::INTEGER),
+                             makeColumn("o_custkey", DataType::INTEGER),
+                             makeColumn("o_orderdate", DataType::INTEGER),
+                             makeColumn("o_totalprice", DataType::DOUBLE),
+                             makeColumn("o_orderpriority", DataType::STRING, 15) });
+}
+static Table lineitemTable() {
+    return Table("lineitem", { makeColumn("l_orderkey", DataType::INTEGER),
+                               makeColumn("l_partkey", DataType::INTEGER),
+                               makeColumn("l_quantity", DataType::FLOAT),
+                               makeColumn("l_extendedprice", DataType::DOUBLE),
+                               makeColumn("l_discount", DataType::FLOAT),
+                               makeColumn("l_tax", DataType::FLOAT),
+                               makeColumn("l_returnflag", DataType::STRING, 1),
+                               makeColumn("l_linestatus", DataType::STRING, 1),
+                               makeColumn("l_shipdate", DataType::INTEGER) });
+}
+
+// -----------------------------------------------------------------------------
+// Row access
+// -----------------------------------------------------------------------------
+class RowView {
+private:
+    const Table& table;
+    const char*  row;
+public:
+    RowView(const Table& t, const char* r) : table(t), row(r) {}
+    int32_t i32(uint32_t col) const { int32_t v; std::memcpy(&v, row + table.offsets[col], sizeof v); return v; }
+    float   f32(uint32_t col) const { float v;   std::memcpy(&v, row + table.offsets[col], sizeof v); return v; }
+    double  f64(uint32_t col) const { double v;  std::memcpy(&v, row + table.offsets[col], sizeof v); return v; }
+    char    chr(uint32_t col) const { return row[table.offsets[col]]; }
+    bool    strEquals(uint32_t col, const char* s) const {
+        return std::strncmp(row + table.offsets[col], s, table.columns[col].dataSize) == 0;
+    }
+};
+
+class RowBuilder {
+private:
+    const Table&      table;
+    std::vector<char> row;
+public:
+    explicit RowBuilder(const Table& t) : table(t), row(t.rowSize, 0) {}
+    RowBuilder& i32(uint32_t col, int32_t v) { std::memcpy(&row[table.offsets[col]], &v, sizeof v); return *this; }
+    RowBuilder& f32(uint32_t col, float v)   { std::memcpy(&row[table.offsets[col]], &v, sizeof v); return *this; }
+    RowBuilder& f64(uint32_t col, double v)  { std::memcpy(&row[table.offsets[col]], &v, sizeof v); return *this; }
+    RowBuilder& str(uint32_t col, const char* s) {
+        std::memset(&row[table.offsets[col]], 0, table.columns[col].dataSize);
+        std::strncpy(&row[table.offsets[col]], s, table.columns[col].dataSize);
+        return *this;
+    }
+    const char* data() const { return row.data(); }
+};
+
+// Appends rows to a table. A page is written once it is full and the number of
+// its successor is known, so the nextPage chain costs no extra I/O.
+class TableWriter {
+private:
+    StorageManager&   storage;
+    Table&            table;
+    std::vector<char> page;
+    uint32_t          pageNumber{0};   // 0 = no page allocated yet
+    uint32_t          rowsOnPage{0};
+
+    ErrorCode writeCurrent(uint32_t nextPage) {
+        auto* header = reinterpret_cast<PageHeader*>(page.data());
+        header->pageType   = static_cast<uint32_t>(PageType::LEAF);
+        header->nextPage   = nextPage;
+        header->entryCount = rowsOnPage;
+        ErrorCode rc = storage.writePage(pageNumber, page.data());
+        std::fill(page.begin(), page.end(), 0);
+        rowsOnPage = 0;
+        pageNumber = nextPage;
+        return rc;
+    }
+
+public:
+    TableWriter(StorageManager& sm, Table& t) : storage(sm), table(t), page(PAGE_SIZE, 0) {}
+
+    ErrorCode append(const char* row) {
+        if (pageNumber == 0) {
+            if (auto rc = storage.allocatePage(pageNumber); rc != ErrorCode::SUCCESS)
+                return rc;
+            table.pages.push_back(pageNumber);
+        } else if (rowsOnPage == table.rowsPerPage) {
+            uint32_t next;
+            if (auto rc = storage.allocatePage(next); rc != ErrorCode::SUCCESS)
+                return rc;
+            table.pages.push_back(next);
+            if (auto rc = writeCurrent(next); rc != ErrorCode::SUCCESS)
+                return rc;
+        }
+        std::memcpy(&page[ROWS_PAGE_OFFSET + rowsOnPage * table.rowSize], row, table.rowSize);
+        ++rowsOnPage;
+        ++table.rows;
+        return ErrorCode::SUCCESS;
+    }
+
+    ErrorCode flush() {
+        return pageNumber == 0 ? ErrorCode::SUCCESS : writeCurrent(0);
+    }
+};
+
+// Full table scan: calls fn(RowView) for every row
+template <typename Fn>
+static ErrorCode scanTable(StorageManager& storage, const Table& table, Fn&& fn) {
+    std::vector<char> page(PAGE_SIZE);
+    for (uint32_t pageNumber : table.pages) {
+        if (auto rc = storage.readPage(pageNumber, page.data()); rc != ErrorCode::SUCCESS)
+            return rc;
+        uint32_t rows = reinterpret_cast<const PageHeader*>(page.data())->entryCount;
+        for (uint32_t r = 0; r < rows; ++r)
+            fn(RowView(table, page.data() + ROWS_PAGE_OFFSET + r * table.rowSize));
+    }
+    return ErrorCode::SUCCESS;
+}
+
+// -----------------------------------------------------------------------------
+// Data generator
+// -----------------------------------------------------------------------------
+struct Database {
+    StorageManager storage;
+    Table customer = customerTable();
+    Table orders   = ordersTable();
+    Table lineitem = lineitemTable();
+};
+
+static ErrorCode generate(Database& db, double scale) {
+    std::mt19937_64 rng(0x7C0D);
+    auto uniformInt  = [&](int32_t lo, int32_t hi) { return std::uniform_int_distribution<int32_t>(lo, hi)(rng); };
+    auto uniformReal = [&](double lo, double hi) { return std::uniform_real_distribution<double>(lo, hi)(rng); };
+
+    auto customers = static_cast<int32_t>(std::max(1.0, 150000 * scale));
+    auto orders    = static_cast<int32_t>(std::max(1.0, 1500000 * scale));
+    auto parts     = static_cast<int32_t>(std::max(1.0, 200000 * scale));
+
+    TableWriter customerOut(db.storage, db.customer);
+    RowBuilder c(db.customer);
+    for (int32_t key = 1; key <= customers; ++key) {
+        c.i32(C_CUSTKEY, key).i32(C_NATIONKEY, uniformInt(0, 24))
+         .str(C_MKTSEGMENT, SEGMENTS[uniformInt(0, 4)])
+         .f64(C_ACCTBAL, uniformReal(-999.99, 9999.99));
+        if (auto rc = customerOut.append(c.data()); rc != ErrorCode::SUCCESS)
+            return rc;
+    }
+
+    TableWriter ordersOut(db.storage, db.orders);
+    TableWriter lineitemOut(db.storage, db.lineitem);
+    RowBuilder o(db.orders);
+    RowBuilder l(db.lineitem);
+    for (int32_t key = 1; key <= orders; ++key) {
+        int32_t orderDate = uniformInt(0, DATE_1998_08_02 - 151);
+        double  total     = 0.0;
+        int     lines     = uniformInt(1, 7);
+        for (int line = 0; line < lines; ++line) {
+            int32_t partKey  = uniformInt(1, parts);
+            auto    quantity = static_cast<float>(uniformInt(1, 50));
+            double  price    = quantity * (900.0 + (partKey % 1000) + 0.01 * (partKey % 100));
+            auto    discount = static_cast<float>(uniformInt(0, 10) / 100.0);
+            auto    tax      = static_cast<float>(uniformInt(0, 8) / 100.0);
+            int32_t shipDate = orderDate + uniformInt(1, 121);
+            int32_t receipt  = shipDate + uniformInt(1, 30);
+            const char* flag = receipt <= DATE_1995_06_17 ? (uniformInt(0, 1) ? "R" : "A") : "N";
+            l.i32(L_ORDERKEY, key).i32(L_PARTKEY, partKey).f32(L_QUANTITY, quantity)
+             .f64(L_EXTENDEDPRICE, price).f32(L_DISCOUNT, discount).f32(L_TAX, tax)
+             .str(L_RETURNFLAG, flag).str(L_LINESTATUS, shipDate > DATE_1995_06_17 ? "O" : "F")
+             .i32(L_SHIPDATE, shipDate);
+            if (auto rc = lineitemOut.append(l.data()); rc != ErrorCode::SUCCESS)
+                return rc;
+            total += price * (1.0 + tax) * (1.0 - discount);
+        }
+        o.i32(O_ORDERKEY, key).i32(O_CUSTKEY, uniformInt(1, customers))
+         .i32(O_ORDERDATE, orderDate).f64(O_TOTALPRICE, total)
+         .str(O_ORDERPRIORITY, PRIORITIES[uniformInt(0, 4)]);
+        if (auto rc = ordersOut.append(o.data()); rc != ErrorCode::SUCCESS)
+            return rc;
+    }
+    for (TableWriter* w : { &customerOut, &ordersOut, &lineitemOut })
+        if (auto rc = w->flush(); rc != ErrorCode::SUCCESS)
+            return rc;
+    return ErrorCode::SUCCESS;
+}
+
+// -----------------------------------------------------------------------------
+// Queries – each returns a checksum so the work cannot be optimised away and
+// results can be compared between builds
+// -----------------------------------------------------------------------------
+
+// Q1: pricing summary report
+static double queryQ1(Database& db) {
+    struct Agg { double qty{}, base{}, disc{}, charge{}, discount{}; uint64_t count{}; };
+    std::map<std::pair<char, char>, Agg> groups;
+    scanTable(db.storage, db.lineitem, [&](const RowView& r) {
+        if (r.i32(L_SHIPDATE) > DATE_1998_09_02)
+            return;
+        Agg& a = groups[{ r.chr(L_RETURNFLAG), r.chr(L_LINESTATUS) }];
+        double price = r.f64(L_EXTENDEDPRICE);
+        double disc  = price * (1.0 - r.f32(L_DISCOUNT));
+        a.qty      += r.f32(L_QUANTITY);
+        a.base     += price;
+        a.disc     += disc;
+        a.charge   += disc * (1.0 + r.f32(L_TAX));
+        a.discount += r.f32(L_DISCOUNT);
+        ++a.count;
+    });
+    double checksum = 0.0;
+    for (const auto& [key, a] : groups)
+        checksum += a.charge + a.qty / static_cast<double>(a.count) + a.discount / static_cast<double>(a.count);
+    return checksum;
+}
+
+// Q3: shipping priority (customer ⋈ orders ⋈ lineitem, top 10 by revenue)
+static double queryQ3(Database& db) {
+    std::unordered_map<int32_t, bool> building;
+    scanTable(db.storage, db.customer, [&](const RowView& r) {
+        if (r.strEquals(C_MKTSEGMENT, "BUILDING"))
+            building[r.i32(C_CUSTKEY)] = true;
+    });
+    std::unordered_map<int32_t, int32_t> orderDates;   // qualifying orderkey → orderdate
+    scanTable(db.storage, db.orders, [&](const RowView& r) {
+        if (r.i32(O_ORDERDATE) < DATE_1995_03_15 && building.count(r.i32(O_CUSTKEY)))
+            orderDates[r.i32(O_ORDERKEY)] = r.i32(O_ORDERDATE);
+    });
+    std::unordered_map<int32_t, double> revenue;
+    scanTable(db.storage, db.lineitem, [&](const RowView& r) {
+        if (r.i32(L_SHIPDATE) > DATE_1995_03_15 && orderDates.count(r.i32(L_ORDERKEY)))
+            revenue[r.i32(L_ORDERKEY)] += r.f64(L_EXTENDEDPRICE) * (1.0 - r.f32(L_DISCOUNT));
+    });
+    using Entry = std::pair<double, int32_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> top;
+    for (const auto& [order, rev] : revenue) {
+        top.emplace(rev, order);
+        if (top.size() > 10)
+            top.pop();
+    }
+    double checksum = 0.0;
+    for (; !top.empty(); top.pop())
+        checksum += top.top().first;
+    return checksum;
+}
+
+// Q6: forecasting revenue change
+static double queryQ6(Database& db) {
+    double revenue = 0.0;
+    scanTable(db.storage, db.lineitem, [&](const RowView& r) {
+        int32_t ship = r.i32(L_SHIPDATE);
+        float   disc = r.f32(L_DISCOUNT);
+        if (ship >= DATE_1994_01_01 && ship < DATE_1995_01_01 &&
+            disc >= 0.05f && disc <= 0.07f && r.f32(L_QUANTITY) < 24.0f)
+            revenue += r.f64(L_EXTENDEDPRICE) * disc;
+    });
+    return revenue;
+}
+
+// Q10: returned item reporting (orders ⋈ lineitem grouped by customer, top 20)
+static double queryQ10(Database& db) {
+    std::unordered_map<int32_t, int32_t> orderCustomer;
+    scanTable(db.storage, db.orders, [&](const RowView& r) {
+        int32_t date = r.i32(O_ORDERDATE);
+        if (date >= DATE_1994_01_01 - 92 && date < DATE_1994_01_01)
+            orderCustomer[r.i32(O_ORDERKEY)] = r.i32(O_CUSTKEY);
+    });
+    std::unordered_map<int32_t, double> lost;
+    scanTable(db.storage, db.lineitem, [&](const RowView& r) {
+        if (r.chr(L_RETURNFLAG) != 'R')
+            return;
+        auto it = orderCustomer.find(r.i32(L_ORDERKEY));
+        if (it != orderCustomer.end())
+            lost[it->second] += r.f64(L_EXTENDEDPRICE) * (1.0 - r.f32(L_DISCOUNT));
+    });
+    std::vector<double> values;
+    for (const auto& entry : lost)
+        values.push_back(entry.second);
+    size_t k = std::min<size_t>(20, values.size());
+    std::partial_sort(values.begin(), values.begin() + k, values.end(), std::greater<double>());
+    double checksum = 0.0;
+    for (size_t i = 0; i < k; ++i)
+        checksum += values[i];
+    return checksum;
+}
+
+// TOPK: the 100 most expensive orders
+static double queryTopK(Database& db) {
+    std::priority_queue<double, std::vector<double>, std::greater<double>> top;
+    scanTable(db.storage, db.orders, [&](const RowView& r) {
+        top.push(r.f64(O_TOTALPRICE));
+        if (top.size() > 100)
+            top.pop();
+    });
+    double checksum = 0.0;
+    for (; !top.empty(); top.pop())
+        checksum += top.top();
+    return checksum;
+}
+
+struct Query {
+    const char* name;
+    double (*run)(Database&);
+};
+static const Query QUERIES[] = {
+    { "Q1",   queryQ1   },
+    { "Q3",   queryQ3   },
+    { "Q6",   queryQ6   },
+    { "Q10",  queryQ10  },
+    { "TOPK", queryTopK },
+};
+
+struct QueryResult {
+    double      scale{};
+    std::string query;
+    double      minSec{};
+    double      medianSec{};
+    double      checksum{};
+};
+
+// -----------------------------------------------------------------------------
+// Driver
+// -----------------------------------------------------------------------------
+static void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options]\n"
+              << "  --db PATH        scratch database file (default tpch_lite.db)\n"
+              << "  --scale LIST     scale factors (default 0.01,0.05)\n"
+              << "  --queries LIST   subset of Q1,Q3,Q6,Q10,TOPK (default all)\n"
+              << "  --runs N         timed runs per query (default 3)\n"
+              << "  --label TEXT     free‑form build label stored in the JSON\n"
+              << "  --json PATH      also write a JSON report\n";
+}
+
+int main(int argc, char* argv[])
+{
+    std::string dbPath = "tpch_lite.db";
+    std::string jsonPath;
+    std::string label;
+    std::string queryList = "Q1,Q3,Q6,Q10,TOPK";
+    std::vector<double> scales{0.01, 0.05};
+    uint32_t runs = 3;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                std::exit(1);
+            }
+            return argv[++i];
+        };
+        if (arg == "--db")           dbPath = next();
+        else if (arg == "--queries") queryList = toUpper(next());
+        else if (arg == "--runs")    runs = static_cast<uint32_t>(std::max(1, std::stoi(next())));
+        else if (arg == "--label")   label = next();
+        else if (arg == "--json")    jsonPath = next();
+        else if (arg == "--scale") {
+            scales.clear();
+            for (const auto& item : splitList(next()))
+                scales.push_back(std::stod(item));
+        } else {
+            usage(argv[0]);
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+    std::vector<const Query*> selected;
+    for (const auto& name : splitList(queryList)) {
+        auto it = std::find_if(std::begin(QUERIES), std::end(QUERIES),
+                               [&](const Query& q) { return name == q.name; });
+        if (it == std::end(QUERIES)) {
+            std::cerr << "tpch_lite: unknown query '" << name << "'\n";
+            return 1;
+        }
+        selected.push_back(&*it);
+    }
+
+    std::vector<QueryResult> results;
+    for (double scale : scales) {
+        std::remove(dbPath.c_str());
+        Database db;
+        if (auto rc = db.storage.open(dbPath); rc != ErrorCode::SUCCESS) {
+            std::cerr << "tpch_lite: cannot open '" << dbPath << "': " << errorMessage(rc) << "\n";
+            return 1;
+        }
+        auto genStart = std::chrono::steady_clock::now();
+        if (auto rc = generate(db, scale); rc != ErrorCode::SUCCESS) {
+            std::cerr << "tpch_lite: data generation failed: " << errorMessage(rc) << "\n";
+            return 1;
+        }
+        std::cerr << "SF " << scale << ": " << db.customer.rows << " customers, " << db.orders.rows
+                  << " orders, " << db.lineitem.rows << " line items, " << db.storage.getPageCount()
+                  << " pages (generated in "
+                  << std::chrono::duration<double>(std::chrono::steady_clock::now() - genStart).count()
+                  << "s)\n";
+
+        for (const Query* q : selected) {
+            std::vector<double> times;
+            QueryResult r;
+            r.scale = scale;
+            r.query = q->name;
+            for (uint32_t run = 0; run < runs; ++run) {
+                auto start = std::chrono::steady_clock::now();
+                r.checksum = q->run(db);
+                times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            }
+            std::sort(times.begin(), times.end());
+            r.minSec    = times.front();
+            r.medianSec = times[times.size() / 2];
+            std::cerr << "  " << std::left << std::setw(5) << r.query << " min=" << r.minSec * 1000.0
+                      << "ms median=" << r.medianSec * 1000.0 << "ms checksum=" << std::fixed
+                      << std::setprecision(2) << r.checksum << std::defaultfloat << std::setprecision(6) << "\n";
+            results.push_back(r);
+        }
+        db.storage.close();
+    }
+    std::remove(dbPath.c_str());
+
+    if (!jsonPath.empty()) {
+        std::ofstream out(jsonPath);
+        if (!out) {
+            std::cerr << "tpch_lite: cannot write '" << jsonPath << "'\n";
+            return 1;
+        }
+        out << std::setprecision(9)
+            << "{\n  \"benchmark\": \"tinydb_tpch_lite\",\n  \"label\": \"" << label
+            << "\",\n  \"runs\": " << runs << ",\n  \"results\": [\n";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const QueryResult& r = results[i];
+            out << "    {\"scale\": " << r.scale << ", \"query\": \"" << r.query
+                << "\", \"min_sec\": " << r.minSec << ", \"median_sec\": " << r.medianSec
+                << ", \"checksum\": " << r.checksum << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+    }
+    return 0;
+}
@@ -0,0 +1,452 @@
+/*****************************************************************************************
+ * ycsb.cpp – YCSB‑style key‑value workload driver for tinydb
+ *
+ *  * Implements the YCSB core workloads A–F.
+ *  * tinydb has no table layer yet, so every YCSB record is one page:
+ *    key k lives in page k + 1, and the record bytes sit at the start of it.
+ *      read   → readPage            update → writePage
+ *      insert → allocatePage + writePage
+ *      scan   → readPage over consecutive keys
+ *      rmw    → readPage + writePage
+ *  * Key choosers: zipfian (scrambled), uniform, latest.
+ *  * Reports throughput and p50/p99/p999 latency per operation.
+ *
+ * Compile (from the repository root):
+ *   g++ -std=c++17 -O2 -Wall -Wextra -pthread -o ycsb bench/ycsb.cpp
+ *
+ * Run:
+ *   ./ycsb --workloads A,B,C,D,E,F --records 100000 --threads 4 --duration 10 \
+ *          --label "$(git describe --always)" --json ycsb.json
+ *
+ *****************************************************************************************/
+
+#define TINYDB_NO_MAIN
+#include "../tinydb.cpp"
+#include "bench_util.h"
+
+#include <cmath>
+
+// -----------------------------------------------------------------------------
+// Configuration
+// -----------------------------------------------------------------------------
+constexpr uint32_t YCSB_KEY_BYTES      = sizeof(uint64_t);   // key prefix of every record
+constexpr uint32_t YCSB_MAX_SCAN       = 100;                // scan length is uniform in [1, max]
+constexpr double   YCSB_ZIPFIAN_THETA  = 0.99;
+
+enum class KeyDistribution : uint32_t {
+    ZIPFIAN = 0,
+    UNIFORM = 1,
+    LATEST  = 2
+};
+enum class YcsbOp : uint32_t {
+    READ   = 0,
+    UPDATE = 1,
+    INSERT = 2,
+    SCAN   = 3,
+    RMW    = 4,
+    COUNT  = 5
+};
+static const char* const YCSB_OP_NAMES[] = { "READ", "UPDATE", "INSERT", "SCAN", "READ-MODIFY-WRITE" };
+
+struct Workload {
+    char            name;
+    double          mix[static_cast<size_t>(YcsbOp::COUNT)];  // operation proportions
+    KeyDistribution distribution;
+};
+
+// Core workloads as defined by YCSB
+static const Workload CORE_WORKLOADS[] = {
+    { 'A', {0.50, 0.50, 0.00, 0.00, 0.00}, KeyDistribution::ZIPFIAN },
+    { 'B', {0.95, 0.05, 0.00, 0.00, 0.00}, KeyDistribution::ZIPFIAN },
+    { 'C', {1.00, 0.00, 0.00, 0.00, 0.00}, KeyDistribution::ZIPFIAN },
+    { 'D', {0.95, 0.00, 0.05, 0.00, 0.00}, KeyDistribution::LATEST  },
+    { 'E', {0.00, 0.00, 0.05, 0.95, 0.00}, KeyDistribution::ZIPFIAN },
+    { 'F', {0.50, 0.00, 0.00, 0.00, 0.50}, KeyDistribution::ZIPFIAN },
+};
+
+struct YcsbConfig {
+    std::string       dbPath{"ycsb.db"};
+    std::string       jsonPath;
+    std::string       label;
+    std::string       workloads{"A,B,C,D,E,F"};
+    uint64_t          records{10000};
+    uint32_t          recordSize{1000};       // YCSB default: 10 fields × 100 bytes
+    uint32_t          threads{1};
+    double            durationSec{5.0};
+    bool              overrideDistribution{false};
+    KeyDistribution   distribution{KeyDistribution::ZIPFIAN};
+};
+
+// -----------------------------------------------------------------------------
+// Zipfian generator (Gray et al., as in YCSB's ZipfianGenerator). The item
+// count may grow; zeta is then extended incrementally.
+// -----------------------------------------------------------------------------
+class ZipfianGenerator {
+private:
+    uint64_t items{0};
+    double   theta;
+    double   zetan{0.0};
+    double   zeta2theta;
+    double   alpha;
+    double   eta{0.0};
+
+    void extendTo(uint64_t n) {
+        for (uint64_t i = items + 1; i <= n; ++i)
+            zetan += 1.0 / std::pow(static_cast<double>(i), theta);
+        items = n;
+        eta = (1.0 - std::pow(2.0 / static_cast<double>(items), 1.0 - theta)) /
+              (1.0 - zeta2theta / zetan);
+    }
+
+public:
+    explicit ZipfianGenerator(uint64_t n, double t = YCSB_ZIPFIAN_THETA)
+        : theta(t), zeta2theta(1.0 + 1.0 / std::pow(2.0, t)), alpha(1.0 / (1.0 - t)) {
+        extendTo(std::max<uint64_t>(n, 2));
+    }
+
+    // Value in [0, n); 0 is the most popular
+    uint64_t next(uint64_t n, std::mt19937_64& rng) {
+        if (n > items)
+            extendTo(n);
+        double u  = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        double uz = u * zetan;
+        if (uz < 1.0)
+            return 0;
+        if (uz < 1.0 + std::pow(0.5, theta))
+            return 1 % n;
+        auto v = static_cast<uint64_t>(static_cast<double>(items) *
+                                       std::pow(eta * u - eta + 1.0, alpha));
+        return std::min<uint64_t>(v, n - 1);
+    }
+};
+
+static uint64_t fnv1a64(uint64_t value) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (int i = 0; i < 8; ++i) {
+        hash ^= (value >> (i * 8)) & 0xFF;
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+// -----------------------------------------------------------------------------
+// Per‑thread key chooser
+// -----------------------------------------------------------------------------
+class KeyChooser {
+private:
+    KeyDistribution  distribution;
+    uint64_t         initialRecords;
+    ZipfianGenerator zipf;
+    std::mt19937_64& rng;
+
+public:
+    KeyChooser(KeyDistribution d, uint64_t records, std::mt19937_64& r)
+        : distribution(d), initialRecords(records), zipf(records), rng(r) {}
+
+    // Choose an existing key given `count` acknowledged records
+    uint64_t next(uint64_t count) {
+        switch (distribution) {
+            case KeyDistribution::UNIFORM:
+                return std::uniform_int_distribution<uint64_t>(0, count - 1)(rng);
+            case KeyDistribution::LATEST:
+                return count - 1 - zipf.next(count, rng);
+            case KeyDistribution::ZIPFIAN:
+            default:
+                // Scrambled: popular keys are spread over the initial key space
+                return fnv1a64(zipf.next(initialRecords, rng)) % initialRecords;
+        }
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Record helpers
+// -----------------------------------------------------------------------------
+static void buildRecord(char* page, uint64_t key, uint32_t recordSize, std::mt19937_64& rng) {
+    std::memcpy(page, &key, YCSB_KEY_BYTES);
+    for (uint32_t i = YCSB_KEY_BYTES; i < recordSize; i += sizeof(uint64_t)) {
+        uint64_t word = rng();
+        std::memcpy(page + i, &word, std::min<uint32_t>(sizeof(word), recordSize - i));
+    }
+}
+
+static uint32_t pageOfKey(uint64_t key) { return static_cast<uint32_t>(key + 1); }
+
+struct OpStats {
+    std::vector<uint64_t> latencies[static_cast<size_t>(YcsbOp::COUNT)];
+    uint64_t              errors{0};
+};
+
+struct WorkloadResult {
+    std::string name;
+    double      seconds{};
+    uint64_t    ops{};
+    uint64_t    errors{};
+    uint64_t    count[static_cast<size_t>(YcsbOp::COUNT)]{};
+    double      p50[static_cast<size_t>(YcsbOp::COUNT)]{};
+    double      p99[static_cast<size_t>(YcsbOp::COUNT)]{};
+    double      p999[static_cast<size_t>(YcsbOp::COUNT)]{};
+};
+
+// -----------------------------------------------------------------------------
+// Driver
+// -----------------------------------------------------------------------------
+class YcsbDriver {
+private:
+    const YcsbConfig&     cfg;
+    StorageManager        storage;
+    std::atomic<uint64_t> acknowledged{0};   // keys [0, acknowledged) are readable
+
+    void acknowledge(uint64_t key) {
+        uint64_t cur = acknowledged.load();
+        while (cur < key + 1 && !acknowledged.compare_exchange_weak(cur, key + 1)) {}
+    }
+
+    ErrorCode insert(char* page, std::mt19937_64& rng) {
+        uint32_t pageNumber;
+        if (auto rc = storage.allocatePage(pageNumber); rc != ErrorCode::SUCCESS)
+            return rc;
+        uint64_t key = pageNumber - 1;
+        buildRecord(page, key, cfg.recordSize, rng);
+        ErrorCode rc = storage.writePage(pageNumber, page);
+        acknowledge(key);
+        return rc;
+    }
+
+    ErrorCode execute(YcsbOp op, KeyChooser& keys, char* page, std::mt19937_64& rng) {
+        switch (op) {
+            case YcsbOp::READ:
+                return storage.readPage(pageOfKey(keys.next(acknowledged)), page);
+            case YcsbOp::UPDATE: {
+                uint64_t key = keys.next(acknowledged);
+                buildRecord(page, key, cfg.recordSize, rng);
+                return storage.writePage(pageOfKey(key), page);
+            }
+            case YcsbOp::INSERT:
+                return insert(page, rng);
+            case YcsbOp::SCAN: {
+                uint64_t count = acknowledged;
+                uint64_t first = keys.next(count);
+                uint64_t len   = std::uniform_int_distribution<uint64_t>(1, YCSB_MAX_SCAN)(rng);
+                for (uint64_t key = first; key < std::min(first + len, count); ++key)
+                    if (auto rc = storage.readPage(pageOfKey(key), page); rc != ErrorCode::SUCCESS)
+                        return rc;
+                return ErrorCode::SUCCESS;
+            }
+            case YcsbOp::RMW: {
+                uint64_t key = keys.next(acknowledged);
+                if (auto rc = storage.readPage(pageOfKey(key), page); rc != ErrorCode::SUCCESS)
+                    return rc;
+                page[YCSB_KEY_BYTES] ^= 1;
+                return storage.writePage(pageOfKey(key), page);
+            }
+            default:
+                return ErrorCode::INVALID_INPUT;
+        }
+    }
+
+public:
+    explicit YcsbDriver(const YcsbConfig& c) : cfg(c) {}
+
+    // -----------------------------------------------------------------
+    // Load phase: insert the initial records
+    // -----------------------------------------------------------------
+    ErrorCode load(double& seconds) {
+        std::remove(cfg.dbPath.c_str());
+        if (auto rc = storage.open(cfg.dbPath); rc != ErrorCode::SUCCESS)
+            return rc;
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        std::atomic<uint64_t> next{0};
+        std::atomic<bool> failed{false};
+        for (uint32_t t = 0; t < cfg.threads; ++t) {
+            workers.emplace_back([&, t] {
+                std::mt19937_64 rng(0x5EED + t);
+                std::vector<char> page(PAGE_SIZE, 0);
+                while (next.fetch_add(1) < cfg.records)
+                    if (insert(page.data(), rng) != ErrorCode::SUCCESS)
+                        failed = true;
+            });
+        }
+        for (auto& w : workers)
+            w.join();
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return failed ? ErrorCode::FILE_IO_ERROR : ErrorCode::SUCCESS;
+    }
+
+    // -----------------------------------------------------------------
+    // Run phase: one workload for the configured duration
+    // -----------------------------------------------------------------
+    WorkloadResult run(const Workload& workload) {
+        KeyDistribution distribution = cfg.overrideDistribution ? cfg.distribution
+                                                                : workload.distribution;
+        std::vector<OpStats> stats(cfg.threads);
+        auto start    = std::chrono::steady_clock::now();
+        auto deadline = start + std::chrono::duration<double>(cfg.durationSec);
+        std::vector<std::thread> workers;
+        for (uint32_t t = 0; t < cfg.threads; ++t) {
+            workers.emplace_back([&, t] {
+                std::mt19937_64 rng(0xC0FFEE + 977 * t + static_cast<uint64_t>(workload.name));
+                KeyChooser keys(distribution, cfg.records, rng);
+                std::discrete_distribution<int> pick(std::begin(workload.mix), std::end(workload.mix));
+                std::vector<char> page(PAGE_SIZE, 0);
+                while (std::chrono::steady_clock::now() < deadline) {
+                    auto op = static_cast<YcsbOp>(pick(rng));
+                    auto begin = std::chrono::steady_clock::now();
+                    if (execute(op, keys, page.data(), rng) != ErrorCode::SUCCESS)
+                        ++stats[t].errors;
+                    stats[t].latencies[static_cast<size_t>(op)].push_back(elapsedNs(begin));
+                }
+            });
+        }
+        for (auto& w : workers)
+            w.join();
+
+        WorkloadResult result;
+        result.name    = std::string("workload") + workload.name;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        for (size_t op = 0; op < static_cast<size_t>(YcsbOp::COUNT); ++op) {
+            std::vector<uint64_t> all;
+            for (auto& s : stats)
+                all.insert(all.end(), s.latencies[op].begin(), s.latencies[op].end());
+            result.count[op] = all.size();
+            result.ops      += all.size();
+            result.p50[op]   = percentile(all, 0.50);
+            result.p99[op]   = percentile(all, 0.99);
+            result.p999[op]  = percentile(all, 0.999);
+        }
+        for (auto& s : stats)
+            result.errors += s.errors;
+        return result;
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Reporting
+// -----------------------------------------------------------------------------
+static void printResult(const WorkloadResult& r) {
+    std::cerr << r.name << ": " << static_cast<uint64_t>(r.ops / r.seconds) << " ops/s ("
+              << r.ops << " ops, " << r.errors << " errors)\n";
+    for (size_t op = 0; op < static_cast<size_t>(YcsbOp::COUNT); ++op) {
+        if (r.count[op] == 0)
+            continue;
+        std::cerr << "  " << std::left << std::setw(18) << YCSB_OP_NAMES[op]
+                  << " count=" << r.count[op]
+                  << " p50=" << r.p50[op] / 1000.0 << "us"
+                  << " p99=" << r.p99[op] / 1000.0 << "us"
+                  << " p999=" << r.p999[op] / 1000.0 << "us\n";
+    }
+}
+
+static void writeJson(std::ostream& out, const YcsbConfig& cfg, double loadSeconds,
+                      const std::vector<WorkloadResult>& results) {
+    out << std::setprecision(6);
+    out << "{\n"
+        << "  \"benchmark\": \"tinydb_ycsb\",\n"
+        << "  \"label\": \"" << cfg.label << "\",\n"
+        << "  \"records\": " << cfg.records << ",\n"
+        << "  \"record_size\": " << cfg.recordSize << ",\n"
+        << "  \"threads\": " << cfg.threads << ",\n"
+        << "  \"load_ops_per_sec\": " << (loadSeconds > 0 ? cfg.records / loadSeconds : 0.0) << ",\n"
+        << "  \"workloads\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const WorkloadResult& r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"seconds\": " << r.seconds
+            << ", \"ops\": " << r.ops << ", \"errors\": " << r.errors
+            << ", \"ops_per_sec\": " << (r.seconds > 0 ? r.ops / r.seconds : 0.0)
+            << ", \"operations\": {";
+        bool first = true;
+        for (size_t op = 0; op < static_cast<size_t>(YcsbOp::COUNT); ++op) {
+            if (r.count[op] == 0)
+                continue;
+            out << (first ? "" : ", ") << "\"" << YCSB_OP_NAMES[op] << "\": {\"count\": "
+                << r.count[op] << ", \"p50_ns\": " << r.p50[op] << ", \"p99_ns\": " << r.p99[op]
+                << ", \"p999_ns\": " << r.p999[op] << "}";
+            first = false;
+        }
+        out << "}}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+static void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options]\n"
+              << "  --db PATH              scratch database file (default ycsb.db)\n"
+              << "  --workloads LIST       subset of A,B,C,D,E,F (default all)\n"
+              << "  --records N            records loaded before the run (default 10000)\n"
+              << "  --record-size BYTES    bytes per record, <= " << PAGE_SIZE << " (default 1000)\n"
+              << "  --threads N            client threads (default 1)\n"
+              << "  --duration SECONDS     run time per workload (default 5)\n"
+              << "  --distribution NAME    override: zipfian, uniform or latest\n"
+              << "  --label TEXT           free‑form build label stored in the JSON\n"
+              << "  --json PATH            also write a JSON report\n";
+}
+
+int main(int argc, char* argv[])
+{
+    YcsbConfig cfg;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                std::exit(1);
+            }
+            return argv[++i];
+        };
+        if (arg == "--db")                cfg.dbPath = next();
+        else if (arg == "--workloads")    cfg.workloads = toUpper(next());
+        else if (arg == "--records")      cfg.records = std::max<uint64_t>(2, std::stoull(next()));
+        else if (arg == "--record-size")  cfg.recordSize = static_cast<uint32_t>(std::stoul(next()));
+        else if (arg == "--threads")      cfg.threads = static_cast<uint32_t>(std::max(1, std::stoi(next())));
+        else if (arg == "--duration")     cfg.durationSec = std::stod(next());
+        else if (arg == "--label")        cfg.label = next();
+        else if (arg == "--json")         cfg.jsonPath = next();
+        else if (arg == "--distribution") {
+            std::string name = toUpper(next());
+            cfg.overrideDistribution = true;
+            if (name == "ZIPFIAN")      cfg.distribution = KeyDistribution::ZIPFIAN;
+            else if (name == "UNIFORM") cfg.distribution = KeyDistribution::UNIFORM;
+            else if (name == "LATEST")  cfg.distribution = KeyDistribution::LATEST;
+            else { usage(argv[0]); return 1; }
+        } else {
+            usage(argv[0]);
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+    if (cfg.recordSize < YCSB_KEY_BYTES || cfg.recordSize > PAGE_SIZE) {
+        std::cerr << "ycsb: --record-size must be between " << YCSB_KEY_BYTES
+                  << " and " << PAGE_SIZE << "\n";
+        return 1;
+    }
+
+    std::vector<WorkloadResult> results;
+    double loadSeconds = 0.0;
+    // Each workload starts from a freshly loaded database, as YCSB runs usually do
+    for (const auto& name : splitList(cfg.workloads)) {
+        auto it = std::find_if(std::begin(CORE_WORKLOADS), std::end(CORE_WORKLOADS),
+                               [&](const Workload& w) { return name.size() == 1 && w.name == name[0]; });
+        if (it == std::end(CORE_WORKLOADS)) {
+            std::cerr << "ycsb: unknown workload '" << name << "'\n";
+            return 1;
+        }
+        YcsbDriver driver(cfg);
+        if (auto rc = driver.load(loadSeconds); rc != ErrorCode::SUCCESS) {
+            std::cerr << "ycsb: load failed: " << errorMessage(rc) << "\n";
+            return 1;
+        }
+        std::cerr << "loaded " << cfg.records << " records in " << loadSeconds << "s\n";
+        results.push_back(driver.run(*it));
+        printResult(results.back());
+    }
+    std::remove(cfg.dbPath.c_str());
+
+    if (!cfg.jsonPath.empty()) {
+        std::ofstream out(cfg.jsonPath);
+        if (!out) {
+            std::cerr << "ycsb: cannot write '" << cfg.jsonPath << "'\n";
+            return 1;
+        }
+        writeJson(out, cfg, loadSeconds, results);
+    }
+    return 0;
+}